@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Decode TWI_TRACE_RECORD dumps produced by twi_trace_drain().
+
+The input is the raw records back to back, 6 bytes each, little endian:
+timestamp (uint16), tw_status, twcr, buffer_ix, action. Read from a file
+or stdin, e.g. a capture of the UART the records were written to.
+"""
+import argparse
+import struct
+import sys
+
+RECORD = struct.Struct("<HBBBB")
+
+STATUS = {
+    0x08: "START",
+    0x10: "REP_START",
+    0x18: "MT_SLA_ACK",
+    0x20: "MT_SLA_NACK",
+    0x28: "MT_DATA_ACK",
+    0x30: "MT_DATA_NACK",
+    0x38: "ARB_LOST",
+    0x40: "MR_SLA_ACK",
+    0x48: "MR_SLA_NACK",
+    0x50: "MR_DATA_ACK",
+    0x58: "MR_DATA_NACK",
+    0x60: "SR_SLA_ACK",
+    0x68: "SR_ARB_LOST_SLA_ACK",
+    0x70: "SR_GCALL_ACK",
+    0x78: "SR_ARB_LOST_GCALL_ACK",
+    0x80: "SR_DATA_ACK",
+    0x88: "SR_DATA_NACK",
+    0x90: "SR_GCALL_DATA_ACK",
+    0x98: "SR_GCALL_DATA_NACK",
+    0xA0: "SR_STOP",
+    0xA8: "ST_SLA_ACK",
+    0xB0: "ST_ARB_LOST_SLA_ACK",
+    0xB8: "ST_DATA_ACK",
+    0xC0: "ST_DATA_NACK",
+    0xC8: "ST_LAST_DATA",
+    0xF8: "NO_INFO",
+    0x00: "BUS_ERROR",
+}
+
+TWCR = [(7, "INT"), (6, "EA"), (5, "STA"), (4, "STO"), (3, "WC"), (2, "EN"), (0, "IE")]
+
+ACTION = [(0x01, "ACK"), (0x02, "NACK"), (0x04, "START"), (0x08, "STOP"), (0x10, "CONT")]
+
+
+def flags(value, names):
+    return "|".join(name for bit, name in names if value & bit) or "-"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("file", nargs="?", help="record dump, stdin if omitted")
+    parser.add_argument("--tick-us", type=float, default=None,
+                        help="timestamp tick in microseconds, print raw ticks if omitted")
+    args = parser.parse_args()
+
+    raw = open(args.file, "rb").read() if args.file else sys.stdin.buffer.read()
+    if len(raw) % RECORD.size:
+        print("warning: %d trailing bytes ignored" % (len(raw) % RECORD.size), file=sys.stderr)
+
+    last = None
+    for timestamp, status, twcr, buffer_ix, action in RECORD.iter_unpack(raw[:len(raw) - len(raw) % RECORD.size]):
+        delta = 0 if last is None else (timestamp - last) & 0xFFFF
+        last = timestamp
+        if args.tick_us is not None:
+            delta = "%10.1fus" % (delta * args.tick_us)
+        else:
+            delta = "%6d" % delta
+        print("%5u %s  %-22s twcr=%-18s ix=%-3u action=%s" % (
+            timestamp, delta,
+            STATUS.get(status, "0x%02X" % status),
+            flags(twcr, [(1 << bit, name) for bit, name in TWCR]),
+            buffer_ix,
+            flags(action, ACTION)))
+
+
+if __name__ == "__main__":
+    main()
@@ -3,20 +3,46 @@
 #include <util/twi.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
 
 #include "twi.h"
 #include "twi_int.h"
 
 static void _twi_handle_complete();
+static TWI_ACTION _twi_nack();
+static uint8_t _twi_next();
+static uint8_t _twi_load();
+static void _twi_rewind();
+static uint8_t _twi_tx_next();
+static void _twi_slave_begin();
+static uint8_t _twi_slave_end(uint8_t start);
+
+#ifdef TWI_TRACE
+static uint8_t trace_action;
+#define TWI_TRACE_ACTION(action) (trace_action = (action))
+#else
+#define TWI_TRACE_ACTION(action) (action)
+#endif
 
 volatile TWI_DATA data = 
 {
   .buffer     = NULL,
   .buffer_ix  = 0,
   .buffer_sz  = 0,
+  .progmem    = 0,
+  .segments   = NULL,
+  .segments_sz = 0,
+  .segment_ix = 0,
   .tw_status  = TW_NO_INFO,
   .address    = 0,
   .timeout    = 0,
+  .posted     = 0,
+  .sched      = 0,
+  .stream     = 0,
+  .scan       = 0,
+  .slave      = 0,
+  .waiting    = TWI_WAITING_NONE,
   .state      = TWI_STATE_NOT_INIT,
 
   // Master Callback Defaults
@@ -53,6 +79,7 @@ TWI_STATUS twi_master2(TWI_INIT2* init)
   data.timeout = init->timeout;
   data.complete_callback = init->complete_callback;
   data.nack_callback = init->nack_callback;
+  _twi_posted_reset();
   PORTC |= _BV(PORTC5) | _BV(PORTC4); // Enable pull-up resistors, JIC
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
   return TWI_OK;
@@ -60,13 +87,24 @@ TWI_STATUS twi_master2(TWI_INIT2* init)
 
 TWI_STATUS twi_reset()
 {
-  uint8_t twbr = TWBR;
-  uint8_t prescaler = TWSR & ~TW_STATUS_MASK;
-  TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWEA));
-  TWBR = twbr;
-  TWSR = prescaler;
-  data.state = TWI_STATE_IDLE;
-  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
+  // A tick kicking the queue part way through would have its START overwritten.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    uint8_t twbr = TWBR;
+    uint8_t prescaler = TWSR & ~TW_STATUS_MASK;
+    TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWEA));
+    TWBR = twbr;
+    TWSR = prescaler;
+    data.state = TWI_STATE_IDLE;
+    data.slave = 0;
+    // Drop the background transfer that was in flight, queued ones carry on.
+    _twi_posted_done();
+    _twi_sched_done();
+    _twi_stream_done();
+    _twi_scan_done();
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
+    _twi_kick();
+  }
   return TWI_OK;
 }
 
@@ -96,20 +134,33 @@ TWI_STATUS twi_stop()
 
 ISR(TWI_vect)
 {
+#ifdef TWI_TRACE
+  uint16_t trace_timestamp = TWI_TRACE_TIMESTAMP();
+  trace_action = 0;
+#endif
   data.tw_status = TW_STATUS;
   switch(data.tw_status)
   {
     case TW_START:
+      _twi_rewind();
       TWDR = data.address;
       TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
       break;
     case TW_REP_START:
+      // A background transfer is not waiting on a caller, send SLA straight away.
+      if (data.posted || data.sched || data.scan)
+      {
+        data.state = TWI_STATE_BUSY;
+        _twi_rewind();
+        TWDR = data.address;
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+      }
       break;
 
     // Master Transmit Cases
     case TW_MT_SLA_ACK:
     case TW_MT_DATA_ACK:
-      if (data.buffer_ix >= data.buffer_sz)
+      if (!_twi_tx_next()) // Load next data byte
       {
         // No more data to send, check what do to next, either 
         // - Repeated Start Condition
@@ -119,8 +170,6 @@ ISR(TWI_vect)
       }
       else
       {
-        // Load next data byte
-        TWDR = data.buffer[data.buffer_ix++];
         TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA) | _BV(TWIE);
       }
       break;
@@ -133,10 +182,10 @@ ISR(TWI_vect)
         // - Stop Condition
         // - Stop Condition Followed by Start Condition
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
-        TWI_ACTION action = data.nack_callback ? data.nack_callback(data.tw_status) : TWI_ACTION_STOP;
+        TWI_ACTION action = TWI_TRACE_ACTION(_twi_nack());
         if (action & TWI_ACTION_CONT)
         {
-          if (data.buffer_ix >= data.buffer_sz)
+          if (!_twi_tx_next()) // Load next data byte
           {
             // No more data to send, check what do to next, either 
             // - Repeated Start Condition
@@ -146,8 +195,6 @@ ISR(TWI_vect)
           }
           else
           {
-            // Load next data byte
-            TWDR = data.buffer[data.buffer_ix++];
             TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA) | _BV(TWIE);
           }
         }
@@ -163,6 +210,8 @@ ISR(TWI_vect)
             data.state = TWI_STATE_REP_START;
             twcr |= _BV(TWSTA);
           }
+          if (data.state == TWI_STATE_IDLE)
+            twcr |= _twi_next();
         }
 
         TWCR = twcr;
@@ -171,13 +220,17 @@ ISR(TWI_vect)
     case TW_MT_ARB_LOST: // this is also TW_MR_ARB_LOST
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
-        TWI_ACTION action = data.nack_callback ? data.nack_callback(data.tw_status) : TWI_ACTION_STOP;
+        TWI_ACTION action = TWI_TRACE_ACTION(_twi_nack());
         data.state = TWI_STATE_IDLE;
         if (action & TWI_ACTION_START)
         {
           data.state = TWI_STATE_REP_START;
           twcr |= _BV(TWSTA);
         }
+        else
+        {
+          twcr |= _twi_next();
+        }
 
         TWCR = twcr;
       }
@@ -185,8 +238,18 @@ ISR(TWI_vect)
 
     // Master Receiver Cases
     case TW_MR_DATA_ACK:
+      if (data.stream)
+      {
+        _twi_stream_rx();
+        break;
+      }
       data.buffer[data.buffer_ix++] = TWDR;
     case TW_MR_SLA_ACK:
+      if (data.stream)
+      {
+        _twi_stream_rx();
+        break;
+      }
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
         if (data.buffer_ix + 1 != data.buffer_sz) // there is room for one more
@@ -197,7 +260,7 @@ ISR(TWI_vect)
     case TW_MR_SLA_NACK: 
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
-        TWI_ACTION action = data.nack_callback ? data.nack_callback(data.tw_status) : TWI_ACTION_STOP;
+        TWI_ACTION action = TWI_TRACE_ACTION(_twi_nack());
         if (action & TWI_ACTION_STOP)
         {
           data.state = TWI_STATE_IDLE;
@@ -208,12 +271,17 @@ ISR(TWI_vect)
           data.state = TWI_STATE_REP_START;
           twcr |= _BV(TWSTA);
         }
+        if (data.state == TWI_STATE_IDLE)
+          twcr |= _twi_next();
 
         TWCR = twcr;
       }
       break;
     case TW_MR_DATA_NACK: // last byte rx'd, nack sent
-      data.buffer[data.buffer_ix] = TWDR;
+      if (data.stream)
+        _twi_stream_rx();
+      else
+        data.buffer[data.buffer_ix] = TWDR;
       _twi_handle_complete();
       break;
 
@@ -224,8 +292,9 @@ ISR(TWI_vect)
     case TW_SR_ARB_LOST_GCALL_ACK:
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        _twi_slave_begin();
         // if the slave has provided a callback for SLA then call it, otherwise always ack
-        TWI_ACTION action = data.sla_callback ? data.sla_callback(TWDR >> 1, data.tw_status) : TWI_ACTION_ACK;
+        TWI_ACTION action = TWI_TRACE_ACTION(data.sla_callback ? data.sla_callback(TWDR >> 1, data.tw_status) : TWI_ACTION_ACK);
         if (action & TWI_ACTION_ACK)
           twcr |= _BV(TWEA);
         TWCR = twcr;
@@ -235,7 +304,7 @@ ISR(TWI_vect)
     case TW_SR_GCALL_DATA_ACK:
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
-        TWI_ACTION action = data.rx_callback ? data.rx_callback(TWDR, data.tw_status) : TWI_ACTION_NACK;
+        TWI_ACTION action = TWI_TRACE_ACTION(data.rx_callback ? data.rx_callback(TWDR, data.tw_status) : TWI_ACTION_NACK);
         if (action & TWI_ACTION_ACK)
           twcr |= _BV(TWEA);
         TWCR = twcr;
@@ -244,11 +313,12 @@ ISR(TWI_vect)
     case TW_SR_STOP:
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
-        TWI_ACTION action = data.stop_callback ? data.stop_callback() : TWI_ACTION_ACK;
+        TWI_ACTION action = TWI_TRACE_ACTION(data.stop_callback ? data.stop_callback() : TWI_ACTION_ACK);
         if (action & TWI_ACTION_ACK)
           twcr |= _BV(TWEA);
         if (action & TWI_ACTION_START)
           twcr |= _BV(TWSTA);
+        twcr |= _twi_slave_end(action & TWI_ACTION_START);
         TWCR = twcr;
       }
       break;
@@ -256,11 +326,12 @@ ISR(TWI_vect)
     case TW_SR_GCALL_DATA_NACK:
       {
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
-        TWI_ACTION action = data.rx_callback ? data.rx_callback(TWDR, data.tw_status) : TWI_ACTION_NACK;
+        TWI_ACTION action = TWI_TRACE_ACTION(data.rx_callback ? data.rx_callback(TWDR, data.tw_status) : TWI_ACTION_NACK);
         if (action & TWI_ACTION_ACK)
           twcr |= _BV(TWEA);
         if (action & TWI_ACTION_START)
           twcr |= _BV(TWSTA);
+        twcr |= _twi_slave_end(action & TWI_ACTION_START);
         TWCR = twcr;
       }
       break;
@@ -268,12 +339,13 @@ ISR(TWI_vect)
     // Save Transmitter Cases
     case TW_ST_SLA_ACK:
     case TW_ST_ARB_LOST_SLA_ACK:
+        _twi_slave_begin();
         if (data.sla_callback)
           data.sla_callback(TWDR >> 1, data.tw_status);
     case TW_ST_DATA_ACK:
       {
         uint8_t twdr;
-        TWI_ACTION action = data.tx_callback(&twdr);
+        TWI_ACTION action = TWI_TRACE_ACTION(data.tx_callback(&twdr));
         TWDR = twdr;
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
         if (action & TWI_ACTION_ACK)
@@ -287,19 +359,27 @@ ISR(TWI_vect)
         uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
         uint8_t action = TWI_ACTION_ACK;
         if (data.last_data_callback)
-          action = data.last_data_callback(data.tw_status);
+          action = TWI_TRACE_ACTION(data.last_data_callback(data.tw_status));
         if (action & TWI_ACTION_ACK)
           twcr |= _BV(TWEA);
         if (action & TWI_ACTION_START)
           twcr |= _BV(TWSTA);
+        twcr |= _twi_slave_end(action & TWI_ACTION_START);
         TWCR = twcr;
       }
       break;
     
     case TW_BUS_ERROR:
+      data.slave = 0;
       twi_stop();
+      if (data.state == TWI_STATE_IDLE && _twi_next())
+        TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
       break;
   }
+
+#ifdef TWI_TRACE
+  _twi_trace(trace_timestamp, trace_action);
+#endif
 }
 
 void _twi_timeout(uint8_t reset)
@@ -308,6 +388,14 @@ void _twi_timeout(uint8_t reset)
     twi_reset();
 }
 
+// The bus is free for a caller: idle, or held by a repeated start the caller's
+// previous transfer requested.
+static uint8_t _twi_ready()
+{
+  return data.state == TWI_STATE_IDLE ||
+    (data.state == TWI_STATE_REP_START && !_twi_background());
+}
+
 TWI_STATUS _twi_wait_for_ready()
 {
   // Wait until state machine is idle (not reading/writing) or a repeated start
@@ -315,7 +403,7 @@ TWI_STATUS _twi_wait_for_ready()
   uint8_t timeout_cntr = data.timeout;
   for (; timeout_cntr > 0; --timeout_cntr)
   {
-    if (data.state == TWI_STATE_IDLE || data.state == TWI_STATE_REP_START)
+    if (_twi_ready())
       break;
     _delay_us(DELAY_US);
   }
@@ -354,55 +442,145 @@ TWI_STATUS _twi_wait_for_rep_start()
   return TWI_OK;
 }
 
-TWI_STATUS _twi_master(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation)
+TWI_STATUS _twi_start(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation, uint8_t stream,
+                      const TWI_MASTER_SEGMENT* segments, uint8_t segments_sz)
 {
-  if (data.state == TWI_STATE_NOT_INIT)
-    return TWI_NOT_INIT;
+  TWI_STATE state;
+  data.waiting = TWI_WAITING_CLAIM; // hold off background transfers, other than earlier posted writes
+  do
+  {
+    if (_twi_wait_for_ready() == TWI_TIMEDOUT)
+    {
+      data.waiting = TWI_WAITING_NONE;
+      _twi_kick();
+      return TWI_TIMEDOUT;
+    }
 
-  data.address = (address << 1) | operation;
-  data.buffer = rw_data->data;
-  data.buffer_sz = rw_data->data_sz;
-  data.buffer_ix = 0;
+    // A background transfer may have been started from another interrupt
+    // since the bus was found ready, so claim it atomically. Posted writes
+    // queued before this transfer are issued first, in order.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      state = _twi_ready() ? data.state : TWI_STATE_BUSY;
+      if (state == TWI_STATE_IDLE && _twi_posted_pending())
+      {
+        state = TWI_STATE_BUSY;
+        _twi_kick();
+      }
+      if (state != TWI_STATE_BUSY)
+      {
+        data.address = (address << 1) | operation;
+        data.buffer = rw_data->data;
+        data.buffer_sz = rw_data->data_sz;
+        data.buffer_ix = 0;
+        data.progmem = rw_data->progmem;
+        data.segments = segments;
+        data.segments_sz = segments_sz;
+        data.segment_ix = 0;
+        data.stream = stream;
+        data.waiting = stream ? TWI_WAITING_NONE : TWI_WAITING_STATUS; // a stream is not waited on
+      }
+      if (state == TWI_STATE_IDLE && data.slave)
+      {
+        // Addressed as a slave, TWI_vect issues the start condition once the
+        // slave exchange has ended.
+        data.state = TWI_STATE_DEFERRED;
+      }
+      else if (state == TWI_STATE_IDLE) // issue start condition
+      {
+        data.state = TWI_STATE_BUSY;
+        uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        if (!rw_data->no_start) // only include TWSTA if not requested to not send a start
+          twcr |= _BV(TWSTA);
 
-  if (_twi_wait_for_ready() == TWI_TIMEDOUT)
-  {
-    return TWI_TIMEDOUT;
-  }
+        TWCR = twcr;
+      }
+    }
+  } while (state == TWI_STATE_BUSY);
 
-  if (data.state == TWI_STATE_REP_START) // Repeated start condition has been issued
+  if (state == TWI_STATE_REP_START) // Repeated start condition has been issued
   {
     if (_twi_wait_for_rep_start() == TWI_TIMEDOUT)
     {
+      data.waiting = TWI_WAITING_NONE;
       return TWI_TIMEDOUT;
     }
   }
-  else // IDLE, issue start condition
-  {
-    data.state = TWI_STATE_BUSY;
-    uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
-    if (!rw_data->no_start) // only include TWSTA if not requested to not send a start
-      twcr |= _BV(TWSTA);
 
-    TWCR = twcr;
-  }
+  return TWI_OK;
+}
+
+TWI_STATUS _twi_master(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (operation == TW_READ && rw_data->progmem)
+    return TWI_INVALID;
 
   if (operation == TW_WRITE && rw_data->posted_write)
   {
-    return TWI_NO_WAIT;
+    return _twi_posted_write(address, rw_data);
   }
 
+  if (_twi_start(address, rw_data, operation, 0, NULL, 0) == TWI_TIMEDOUT)
+  {
+    return TWI_TIMEDOUT;
+  }
+
+  return _twi_wait_for_complete();
+}
+
+TWI_STATUS _twi_wait_for_complete()
+{
   if (_twi_wait_for_ready() == TWI_TIMEDOUT)
   {
+    // Withdraw the transfer if it is still waiting on a slave exchange.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      if (data.state == TWI_STATE_DEFERRED)
+        data.state = TWI_STATE_IDLE;
+      data.waiting = TWI_WAITING_NONE;
+    }
+    // If the transfer is still in flight TWI_vect chains the queue once it ends.
+    _twi_kick();
     return TWI_TIMEDOUT;
   }
 
-  return data.tw_status;
+  // Nothing has been chained since this transfer ended, so the status is
+  // still its own. Background transfers that became pending meanwhile start now.
+  TWI_STATUS status = data.tw_status;
+  data.waiting = TWI_WAITING_NONE;
+  _twi_kick();
+  return status;
+}
+
+void _twi_kick()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (data.state == TWI_STATE_IDLE && !_twi_background() && !data.slave && _twi_load())
+    {
+      TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+    }
+  }
 }
 
 static void _twi_handle_complete()
 {
   uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
-  TWI_ACTION action = data.complete_callback ? data.complete_callback(data.tw_status) : TWI_ACTION_STOP;
+  TWI_ACTION action = TWI_ACTION_STOP;
+  if (data.sched)
+    action = _twi_sched_complete();
+  else if (data.scan)
+    action = _twi_scan_probe(1);
+  else if (data.stream)
+    action = TWI_ACTION_STOP;
+  else if (data.complete_callback)
+    action = data.complete_callback(data.tw_status);
+  if (data.posted) // posted writes always end with a STOP
+    action = TWI_ACTION_STOP;
+  action = TWI_TRACE_ACTION(action);
   if (action & TWI_ACTION_STOP)
   {
     data.state = TWI_STATE_IDLE;
@@ -413,6 +591,105 @@ static void _twi_handle_complete()
     data.state = TWI_STATE_REP_START;
     twcr |= _BV(TWSTA);
   }
+  if (data.state == TWI_STATE_IDLE)
+    twcr |= _twi_next();
 
   TWCR = twcr;
 }
+
+static TWI_ACTION _twi_nack()
+{
+  // A scan probe that lost arbitration is retried, any other NACK is an
+  // absent device.
+  if (data.scan)
+    return data.tw_status == TW_MT_ARB_LOST ? TWI_ACTION_STOP : _twi_scan_probe(0);
+  // Posted writes, scheduled and streaming reads have no caller to decide, give
+  // up on the transfer.
+  if (data.posted || data.sched || data.stream || !data.nack_callback)
+    return TWI_ACTION_STOP;
+  return data.nack_callback(data.tw_status);
+}
+
+// Called from TWI_vect once a transfer has ended and the bus released, chain
+// the next background transfer. A caller still waiting for the status of the
+// transfer keeps the bus idle and starts it itself, see _twi_wait_for_complete,
+// a caller that has given up does not hold up the queue.
+static uint8_t _twi_next()
+{
+  _twi_posted_done();
+  _twi_sched_done();
+  _twi_stream_done();
+  _twi_scan_done();
+  return _twi_load() ? _BV(TWSTA) : 0;
+}
+
+// Load the next pending background transfer. A caller waiting to claim the bus
+// only lets the posted writes queued ahead of it go first, one waiting for its
+// status holds off everything, the caller starts it once done.
+static uint8_t _twi_load()
+{
+  if (data.waiting == TWI_WAITING_CLAIM)
+    return _twi_posted_load();
+  if (data.waiting)
+    return 0;
+  return _twi_sched_load() || _twi_posted_load() || _twi_scan_load();
+}
+
+// Addressed as a slave. A master transfer in flight, or whose start condition
+// was still waiting for the bus, is restarted once the slave exchange ends.
+static void _twi_slave_begin()
+{
+  data.slave = 1;
+  if (data.state == TWI_STATE_BUSY)
+    data.state = TWI_STATE_DEFERRED;
+}
+
+// The slave exchange has ended, start the master transfer held back by it. A
+// START the slave callback asked for is left to the application's transfer,
+// see TWI_MASTER_RW::no_start.
+static uint8_t _twi_slave_end(uint8_t start)
+{
+  data.slave = 0;
+  if (data.state == TWI_STATE_DEFERRED)
+  {
+    data.state = TWI_STATE_BUSY;
+    return _BV(TWSTA);
+  }
+  if (!start && data.state == TWI_STATE_IDLE && !_twi_background() && _twi_load())
+    return _BV(TWSTA);
+  return 0;
+}
+
+// Rewind the transfer in flight to its first byte, for a (re)start.
+static void _twi_rewind()
+{
+  data.buffer_ix = 0;
+  if (data.segments_sz)
+  {
+    data.segment_ix = 0;
+    data.buffer = (uint8_t*)data.segments[0].data;
+    data.buffer_sz = data.segments[0].data_sz;
+    data.progmem = data.segments[0].progmem;
+  }
+}
+
+// Load the next byte to transmit into TWDR, moving on to the next segment once
+// the current one is exhausted. Returns 0 if there is nothing left to send.
+static uint8_t _twi_tx_next()
+{
+  while (data.buffer_ix >= data.buffer_sz)
+  {
+    if (data.segment_ix + 1 >= data.segments_sz)
+      return 0;
+
+    const TWI_MASTER_SEGMENT* segment = &data.segments[++data.segment_ix];
+    data.buffer = (uint8_t*)segment->data;
+    data.buffer_sz = segment->data_sz;
+    data.progmem = segment->progmem;
+    data.buffer_ix = 0;
+  }
+
+  const uint8_t* byte = &data.buffer[data.buffer_ix++];
+  TWDR = data.progmem ? pgm_read_byte(byte) : *byte;
+  return 1;
+}
@@ -15,9 +15,117 @@
 #define DELAY_US 5 
 #endif
 
+#ifndef TWI_POSTED_BLOCK_SZ
+/**
+ * @brief The size in bytes of each block in the posted write pool. Posted
+ *        writes larger than this cannot be staged, see #TWI_POSTED_WAIT.
+ */
+#define TWI_POSTED_BLOCK_SZ 8
+#endif
+
+#ifndef TWI_POSTED_BLOCK_CNT
+/**
+ * @brief The number of blocks in the posted write pool, i.e. the number of
+ *        posted writes that can be queued at any one time.
+ */
+#define TWI_POSTED_BLOCK_CNT 4
+#endif
+
+#if TWI_POSTED_BLOCK_CNT < 1 || TWI_POSTED_BLOCK_CNT > 254
+#error "TWI_POSTED_BLOCK_CNT must be between 1 and 254"
+#endif
+
+/**
+ * @brief Define to make a posted write wait for a free block when the pool is
+ *        exhausted instead of failing with TWI_POOL_FULL. Waiting is bounded
+ *        by TWI_INIT::timeout. With this defined a posted write larger than
+ *        #TWI_POSTED_BLOCK_SZ is completed as a regular, blocking write.
+ */
+// #define TWI_POSTED_WAIT
+
 // #define TWI_NO_SLAVE
 // #define TWI_NO_MASTER
 
+/**
+ * @brief Define to record every TWI_vect entry in a ::TWI_TRACE_RECORD ring,
+ *        see ::twi_trace_drain.
+ */
+// #define TWI_TRACE
+
+#ifndef TWI_TRACE_SZ
+/**
+ * @brief The number of records held by the trace ring. Must be a power of 2
+ *        no larger than 128. Once full the oldest records are overwritten.
+ */
+#define TWI_TRACE_SZ 32
+#endif
+
+#if TWI_TRACE_SZ < 1 || (TWI_TRACE_SZ & (TWI_TRACE_SZ - 1)) || TWI_TRACE_SZ > 128
+#error "TWI_TRACE_SZ must be a power of 2 no larger than 128"
+#endif
+
+/**
+ * @brief Define to build the periodic read scheduler, see ::twi_sched.
+ */
+// #define TWI_SCHED
+
+#ifndef TWI_SCHED_MAX_JOBS
+/**
+ * @brief The maximum number of jobs passed to ::twi_sched.
+ */
+#define TWI_SCHED_MAX_JOBS 8
+#endif
+
+#ifndef TWI_SCHED_DATA_SZ
+/**
+ * @brief The maximum number of bytes read by a scheduled job.
+ */
+#define TWI_SCHED_DATA_SZ 6
+#endif
+
+/**
+ * @brief Define to build the bus scanner, see ::twi_scan.
+ */
+// #define TWI_SCAN
+
+#ifndef TWI_SCAN_BURST
+/**
+ * @brief The number of addresses probed back to back, with repeated starts,
+ *        before the scanner releases the bus to other transfers.
+ */
+#define TWI_SCAN_BURST 4
+#endif
+
+/**
+ * @brief Define to build streaming master reads, see ::twi_master_rx_stream.
+ */
+// #define TWI_STREAM
+
+/**
+ * @brief Define to build the polled master, see ::twi_master_tx_polled.
+ */
+// #define TWI_POLLED
+
+#ifndef TWI_POLLED_TIMEOUT_US
+/**
+ * @brief Approximate time in microseconds a polled transfer may take, from
+ *        waiting for the bus to the STOP condition, before it times out.
+ */
+#define TWI_POLLED_TIMEOUT_US 2000
+#endif
+
+#ifndef TWI_TRACE_TIMESTAMP
+/**
+ * @brief Expression sampled on TWI_vect entry for TWI_TRACE_RECORD::timestamp,
+ *        e.g. TCNT0 or a tick counter kept by the application. Defaults to 0,
+ *        no timestamps.
+ * @note Avoid a 16 bit timer register such as TCNT1. Reading it in TWI_vect
+ *       overwrites the TEMP register shared by all 16 bit timer accesses,
+ *       corrupting any the application makes with interrupts enabled.
+ */
+#define TWI_TRACE_TIMESTAMP() 0
+#endif
+
 /**
  * @brief Construct the slave address with general call support.
  * @param address The slave address to construct
@@ -98,6 +206,8 @@ typedef enum
   TWI_SR_STOP               = TW_SR_STOP,                 /*!< A Stop or Repeated Start condition has been received while addressed */
   TWI_NO_INFO               = TW_NO_INFO,                 /*!< No relevent status code */
   TWI_BUS_ERROR             = TW_BUS_ERROR,               /*!< Illegal start or stop condition */
+  TWI_INVALID               = 0xFB,                       /*!< Invalid argument */
+  TWI_POOL_FULL             = 0xFC,                       /*!< TWI master posted write pool exhausted */
   TWI_NOT_INIT              = 0xFD,                       /*!< TWI master not initializd */
   TWI_NO_WAIT               = 0xFE,                       /*!< TWI master posted write issued */
   TWI_TIMEDOUT              = 0xFF                        /*!< TWI timed out waiting for valid condition to continue. */
@@ -117,7 +227,8 @@ typedef enum
  * TWI_MR_ARB_LOST | Will Release Bus [default] | Will issue START Condition | N/A
  *
  * @note Respected values returned from this function depend on value of
- *       status. Values not listed are N/A.
+ *       status. Values not listed are N/A. Not called for posted writes, which
+ *       are dropped, see ::twi_posted_dropped.
  */
 typedef TWI_ACTION (*TWI_MASTER_NACK)(TWI_STATUS status);
 
@@ -208,6 +319,21 @@ typedef TWI_ACTION (*TWI_SLAVE_TX)(uint8_t* data);
  */
 typedef TWI_ACTION (*TWI_SLAVE_LAST_DATA)(TWI_STATUS status);
 
+/**
+ * @brief Called from the TWI interrupt when a streaming read has filled its
+ *        ring to TWI_MASTER_STREAM::watermark, and when the stream ends.
+ * @param available The number of bytes waiting to be read with ::twi_stream_read.
+ */
+typedef void (*TWI_STREAM_WATERMARK)(uint8_t available);
+
+/**
+ * @brief Called from the TWI interrupt when the scanner finds a device has
+ *        appeared or disappeared.
+ * @param address The slave address
+ * @param present 1 if the device ACK'd its address, 0 if it no longer does
+ */
+typedef void (*TWI_SCAN_CHANGE)(uint8_t address, uint8_t present);
+
 /**
  * @brief Structure used to initialize the TWI master.
  */
@@ -240,10 +366,33 @@ typedef struct
 {
   uint8_t* data;          /*!< The buffer used to send or receive data. */
   uint8_t  data_sz;       /*!< Number of bytes available in TWI_MASTER_RW::data */
-  uint8_t  no_start;      /*!< Don't issue a start condition. This should be set to 1 if a slave mode issued a Start Condition. */
-  uint8_t  posted_write;  /*!< Complete a posted write, do not wait for all bytes to be issued to slave. */
+  uint8_t  no_start;      /*!< Don't issue a start condition. This should be set to 1 if a slave mode issued a Start Condition. Transfers requested while addressed as a slave are deferred until the slave exchange ends and do not need this. No background transfer is started on the START the slave callback asked for, but one kicked by ::twi_sched_tick or ::twi_scan_tick before this transfer is requested can still take it. */
+  uint8_t  posted_write;  /*!< Complete a posted write, do not wait for all bytes to be issued to slave. The data is copied into the posted write pool, TWI_MASTER_RW::data may be reused as soon as the call returns. */
+  uint8_t  progmem;       /*!< TWI_MASTER_RW::data points into program memory (PROGMEM). Transmit only. Posted writes from program memory are not copied and are not limited to #TWI_POSTED_BLOCK_SZ. */
 } TWI_MASTER_RW;
 
+/**
+ * @brief A segment of a transmission, see ::twi_master_tx_segments.
+ */
+typedef struct
+{
+  const uint8_t* data;    /*!< The data to send, in RAM or program memory. */
+  uint8_t  data_sz;       /*!< Number of bytes in TWI_MASTER_SEGMENT::data */
+  uint8_t  progmem;       /*!< TWI_MASTER_SEGMENT::data points into program memory (PROGMEM). */
+} TWI_MASTER_SEGMENT;
+
+/**
+ * @brief Structure used to start a streaming master read.
+ */
+typedef struct
+{
+  uint8_t* buffer;                          /*!< Storage for the ring the stream is received into. */
+  uint8_t  buffer_sz;                       /*!< Number of bytes available in TWI_MASTER_STREAM::buffer */
+  uint16_t count;                           /*!< Number of bytes to read, 0 to read until ::twi_stream_stop. */
+  uint8_t  watermark;                       /*!< Number of bytes in the ring that triggers TWI_MASTER_STREAM::watermark_callback */
+  TWI_STREAM_WATERMARK watermark_callback;  /*!< ::TWI_STREAM_WATERMARK. Not required. */
+} TWI_MASTER_STREAM;
+
 /**
  * @brief The TWI slave callback configuration.
  */
@@ -292,10 +441,24 @@ TWI_STATUS twi_disable();
  * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
  * TWI_TIMEDOUT | A timeout occurred waiting for correct condition
  * TWI_NO_WAIT | Caller requested a posted write
+ * TWI_POOL_FULL | Posted write could not be staged, see #TWI_POSTED_WAIT
  * TWI_MT_* | See ::TWI_STATUS
+ *
+ * @note Posted writes are queued behind any transfer in flight and issued in
+ *       order, each terminated with a STOP condition. A blocking transfer
+ *       waits for the posted writes queued before it to be issued. The value returned from
+ *       ::TWI_MASTER_COMPLETE is ignored for posted writes.
  */
 TWI_STATUS twi_master_tx(uint8_t address, TWI_MASTER_RW* tx_data);
 
+/**
+ * @brief Get and clear the number of posted writes dropped since the last
+ *        call because the slave NACK'd, arbitration was lost or the bus was
+ *        reset.
+ * @return The number of posted writes dropped, saturating at 255
+ */
+uint8_t twi_posted_dropped();
+
 /**
  * @brief Start a reception of data from a slave.
  * @param address The slave address
@@ -304,11 +467,156 @@ TWI_STATUS twi_master_tx(uint8_t address, TWI_MASTER_RW* tx_data);
  * TWI_STATUS | Description
  * ---|---
  * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | TWI_MASTER_RW::progmem is set
  * TWI_TIMEDOUT | A timeout occurred waiting for correct condition
  * TWI_MR_* | See ::TWI_STATUS
  */
 TWI_STATUS twi_master_rx(uint8_t address, TWI_MASTER_RW* rx_data);
 
+/**
+ * @brief Transmit several segments of data to a slave in one transaction,
+ *        e.g. a command byte from RAM followed by a table in program memory.
+ *        Bytes in program memory are read as they are sent, without a copy.
+ * @param address The slave or general address
+ * @param segments The segments to send, in order. Must remain valid until the
+ *                 transfer completes.
+ * @param segments_sz Number of segments, at least 1
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | segments_sz is 0
+ * TWI_TIMEDOUT | A timeout occurred waiting for correct condition
+ * TWI_MT_* | See ::TWI_STATUS
+ */
+TWI_STATUS twi_master_tx_segments(uint8_t address, const TWI_MASTER_SEGMENT* segments, uint8_t segments_sz);
+
+#ifdef TWI_SCAN
+/**
+ * @brief Start scanning a range of addresses for devices. Each address is
+ *        probed with SLA+W only, from the TWI interrupt, and the result kept
+ *        in a presence cache. The scan runs between other transfers, as a
+ *        series of #TWI_SCAN_BURST address bursts.
+ * @param first The first slave address to probe
+ * @param last The last slave address to probe, up to 127
+ * @param period Number of ::twi_scan_tick calls between re-scans, 0 to scan once
+ * @param change_callback ::TWI_SCAN_CHANGE. Not required. Devices found by the
+ *                        first scan are reported as appeared.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NO_WAIT | The scan has started
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | Invalid address range
+ */
+TWI_STATUS twi_scan(uint8_t first, uint8_t last, uint16_t period, TWI_SCAN_CHANGE change_callback);
+
+/**
+ * @brief Advance the re-scan period by one tick. Call this periodically,
+ *        e.g. from a timer interrupt.
+ */
+void twi_scan_tick();
+
+/**
+ * @brief Check the presence cache for a device.
+ * @param address The slave address
+ * @return 1 if the device ACK'd its address when last probed, 0 otherwise
+ */
+uint8_t twi_scan_present(uint8_t address);
+
+/**
+ * @brief Get the state of the scan.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NO_WAIT | A scan is in progress
+ * TWI_NO_INFO | No scan has been started
+ * TWI_OK | The last scan completed, the presence cache is up to date
+ */
+TWI_STATUS twi_scan_status();
+#endif
+
+#ifdef TWI_STREAM
+/**
+ * @brief Start a streaming read from a slave. Bytes are ACK'd into a ring
+ *        until TWI_MASTER_STREAM::count is reached or ::twi_stream_stop is called,
+ *        all in a single transaction. When the ring is full SCL is held low
+ *        until ::twi_stream_read makes room.
+ * @param address The slave address
+ * @param stream Populated ::TWI_MASTER_STREAM structure. Only TWI_MASTER_STREAM::buffer
+ *               must remain valid while streaming.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NO_WAIT | The stream has started
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | A stream is already running or TWI_MASTER_STREAM::buffer_sz is 0
+ * TWI_TIMEDOUT | A timeout occurred waiting for correct condition
+ */
+TWI_STATUS twi_master_rx_stream(uint8_t address, TWI_MASTER_STREAM* stream);
+
+/**
+ * @brief Read bytes received by the stream.
+ * @param[out] buffer Buffer to copy the bytes to
+ * @param buffer_sz Maximum number of bytes to copy
+ * @return The number of bytes copied
+ */
+uint8_t twi_stream_read(uint8_t* buffer, uint8_t buffer_sz);
+
+/**
+ * @brief Ask the stream to stop. The byte in flight is ACK'd, so one more
+ *        byte is received and NACK'd before the STOP condition. If the ring
+ *        is full that byte waits for ::twi_stream_read to make room.
+ * @return TWI_OK
+ */
+TWI_STATUS twi_stream_stop();
+
+/**
+ * @brief Get the state of the stream.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NO_WAIT | The stream is running
+ * TWI_NO_INFO | No stream has been started
+ * TWI_MR_DATA_NACK | The stream completed
+ * Other | The stream ended with this status, see ::TWI_STATUS
+ */
+TWI_STATUS twi_stream_status();
+#endif
+
+#ifdef TWI_POLLED
+/**
+ * @brief Transmit data to a slave without using the TWI interrupt. TWINT is
+ *        polled with TWIE cleared, so this may be used with interrupts
+ *        disabled. Master callbacks are not called, a NACK or lost
+ *        arbitration ends the transfer. TWI_MASTER_RW::posted_write is ignored.
+ * @param address The slave or general address
+ * @param tx_data Populated ::TWI_MASTER_RW structure with data, data size, etc.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_TIMEDOUT | The bus was not released, e.g. to a caller yet to collect its status, or the transfer did not complete within #TWI_POLLED_TIMEOUT_US
+ * TWI_MT_* | See ::TWI_STATUS
+ */
+TWI_STATUS twi_master_tx_polled(uint8_t address, TWI_MASTER_RW* tx_data);
+
+/**
+ * @brief Receive data from a slave without using the TWI interrupt, see
+ *        ::twi_master_tx_polled.
+ * @param address The slave address
+ * @param rx_data Populated ::TWI_MASTER_RW structure with data, and data size.
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | TWI_MASTER_RW::data_sz is 0 or TWI_MASTER_RW::progmem is set
+ * TWI_TIMEDOUT | The transfer did not complete within #TWI_POLLED_TIMEOUT_US
+ * TWI_MR_* | See ::TWI_STATUS
+ */
+TWI_STATUS twi_master_rx_polled(uint8_t address, TWI_MASTER_RW* rx_data);
+#endif
+
 /**
  * @brief Initialize the TWI slave.
  * @param address The slave address shifted with optional general call bit set.
@@ -321,4 +629,107 @@ TWI_STATUS twi_master_rx(uint8_t address, TWI_MASTER_RW* rx_data);
  */
 TWI_STATUS twi_slave(uint8_t address, uint8_t address_mask, TWI_SLAVE_CALLBACKS* callbacks);
 
+#ifdef TWI_SCHED
+/**
+ * @brief A periodic read job: write TWI_SCHED_JOB::reg, then read
+ *        TWI_SCHED_JOB::data_sz bytes after a repeated start.
+ */
+typedef struct
+{
+  uint8_t  address;   /*!< The slave address */
+  uint8_t  reg;       /*!< The register address written before reading */
+  uint8_t  data_sz;   /*!< Number of bytes to read, 1 to #TWI_SCHED_DATA_SZ */
+  uint16_t period;    /*!< Number of ::twi_sched_tick calls between reads, non zero */
+} TWI_SCHED_JOB;
+
+/**
+ * @brief The result of a scheduled read.
+ */
+typedef struct
+{
+  uint8_t  seq;                       /*!< Incremented each time a sample is published, never 0 once one has been */
+  uint16_t timestamp;                 /*!< ::twi_sched_tick count when the sample was published */
+  uint8_t  data[TWI_SCHED_DATA_SZ];   /*!< The data read */
+} TWI_SCHED_SAMPLE;
+
+/**
+ * @brief Start running a table of periodic read jobs. The jobs are issued back
+ *        to back from the TWI interrupt, between any caller transfers and
+ *        posted writes. Master callbacks are not called for scheduled reads.
+ * @param jobs The job table, it must remain valid until ::twi_sched_stop.
+ * @param count The number of jobs, up to #TWI_SCHED_MAX_JOBS
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_OK | Scheduler started, each job runs on the next tick
+ * TWI_NOT_INIT | TWI master not initialized. Call ::twi_master.
+ * TWI_INVALID | Too many jobs, or a job with an invalid size or period
+ */
+TWI_STATUS twi_sched(const TWI_SCHED_JOB* jobs, uint8_t count);
+
+/**
+ * @brief Stop running the periodic read jobs. A job in flight ends with a STOP
+ *        once its current phase completes and its result is discarded.
+ * @return TWI_OK
+ */
+TWI_STATUS twi_sched_stop();
+
+/**
+ * @brief Advance the scheduler by one tick and start any job that is due.
+ *        Call this from a periodic timer interrupt.
+ */
+void twi_sched_tick();
+
+/**
+ * @brief Get the latest sample of a job.
+ * @param job The index of the job in the table passed to ::twi_sched
+ * @param[out] sample The latest consistent sample
+ * @return
+ * TWI_STATUS | Description
+ * ---|---
+ * TWI_OK | The last read of the job succeeded
+ * TWI_NO_INFO | The job has not completed yet, sample is not set
+ * TWI_INVALID | No such job
+ * Other | The last read failed with this status, sample is the last good one. TWI_SCHED_SAMPLE::seq is 0 if there is none.
+ */
+TWI_STATUS twi_sched_read(uint8_t job, TWI_SCHED_SAMPLE* sample);
+#endif
+
+#ifdef TWI_TRACE
+/**
+ * @brief A trace record, appended on every TWI_vect entry. The layout is
+ *        stable, 6 bytes little endian, as parsed by tools/twi_trace_decode.py.
+ */
+typedef struct
+{
+  uint16_t timestamp;   /*!< #TWI_TRACE_TIMESTAMP on entry */
+  uint8_t  tw_status;   /*!< TW_STATUS on entry */
+  uint8_t  twcr;        /*!< TWCR on exit. TWINT is set if the bus was left held. */
+  uint8_t  buffer_ix;   /*!< Master buffer index on exit */
+  uint8_t  action;      /*!< ::TWI_ACTION acted on, from a callback or its default. 0 if none applied. */
+} TWI_TRACE_RECORD;
+
+/**
+ * @brief Copy the oldest trace records without removing them.
+ * @param[out] records Buffer to copy the records to
+ * @param count The maximum number of records to copy
+ * @return The number of records copied
+ */
+uint8_t twi_trace_snapshot(TWI_TRACE_RECORD* records, uint8_t count);
+
+/**
+ * @brief Copy and remove the oldest trace records.
+ * @param[out] records Buffer to copy the records to
+ * @param count The maximum number of records to copy
+ * @return The number of records copied
+ */
+uint8_t twi_trace_drain(TWI_TRACE_RECORD* records, uint8_t count);
+
+/**
+ * @brief Get and clear the number of records overwritten before being drained.
+ * @return The number of records lost, saturating at 255
+ */
+uint8_t twi_trace_lost();
+#endif
+
 #endif // __TWI_H__
@@ -12,17 +12,35 @@ typedef enum
   TWI_STATE_BUSY      = 2,
   TWI_STATE_REP_START = 4,
   TWI_STATE_STOPPING  = 8,
+  TWI_STATE_DEFERRED  = 16,   // master transfer waiting for the slave exchange to end
 } TWI_STATE;
 
+typedef enum
+{
+  TWI_WAITING_NONE    = 0,
+  TWI_WAITING_CLAIM   = 1,    // caller waiting for the bus, posted writes queued ahead go first
+  TWI_WAITING_STATUS  = 2,    // caller's transfer claimed the bus, nothing starts until it has the status
+} TWI_WAITING;
+
 typedef struct
 {
   // Master Transmit/Receive
   uint8_t*  buffer;
   uint8_t   buffer_ix;
   uint8_t   buffer_sz;
+  uint8_t   progmem;    // buffer points into program memory
+  const TWI_MASTER_SEGMENT* segments;
+  uint8_t   segments_sz;
+  uint8_t   segment_ix;
   uint8_t   address;
   uint8_t   tw_status;
   uint8_t   timeout;
+  uint8_t   posted;     // transfer in flight is the head of the posted write queue
+  uint8_t   sched;      // transfer in flight is a scheduled read
+  uint8_t   stream;     // transfer in flight is a streaming read
+  uint8_t   scan;       // transfer in flight is a bus scan burst
+  uint8_t   slave;      // addressed as a slave
+  uint8_t   waiting;    // a caller is waiting to claim the bus or to collect its status, see TWI_WAITING
   TWI_STATE state;
 
   // Master Mode Callbacks
@@ -38,10 +56,63 @@ typedef struct
 } TWI_DATA;
 
 extern volatile TWI_DATA data;
+
+// The transfer in flight is not waited on by a caller.
+static inline uint8_t _twi_background()
+{
+  return data.posted || data.sched || data.stream || data.scan;
+}
+
 void _twi_timeout(uint8_t reset);
 TWI_STATUS _twi_wait_for_ready();
 TWI_STATUS _twi_wait_for_rep_start();
+TWI_STATUS _twi_start(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation, uint8_t stream,
+                      const TWI_MASTER_SEGMENT* segments, uint8_t segments_sz);
+TWI_STATUS _twi_wait_for_complete();
 TWI_STATUS _twi_master(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation);
+void _twi_kick();
+
+// Posted write pool
+void _twi_posted_reset();
+uint8_t _twi_posted_load();
+void _twi_posted_done();
+uint8_t _twi_posted_pending();
+TWI_STATUS _twi_posted_write(uint8_t address, TWI_MASTER_RW* tx_data);
+
+// Periodic read scheduler
+#ifdef TWI_SCHED
+uint8_t _twi_sched_load();
+void _twi_sched_done();
+TWI_ACTION _twi_sched_complete();
+#else
+#define _twi_sched_load() 0
+#define _twi_sched_done()
+#define _twi_sched_complete() TWI_ACTION_STOP
+#endif
+
+// Bus scan
+#ifdef TWI_SCAN
+uint8_t _twi_scan_load();
+void _twi_scan_done();
+TWI_ACTION _twi_scan_probe(uint8_t ack);
+#else
+#define _twi_scan_load() 0
+#define _twi_scan_done()
+#define _twi_scan_probe(ack) TWI_ACTION_STOP
+#endif
+
+// Streaming reads
+#ifdef TWI_STREAM
+void _twi_stream_rx();
+void _twi_stream_done();
+#else
+#define _twi_stream_rx()
+#define _twi_stream_done()
+#endif
+
+#ifdef TWI_TRACE
+void _twi_trace(uint16_t timestamp, uint8_t action);
+#endif
 
 #endif // __TWI_INT_H__
 
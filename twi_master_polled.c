@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#ifdef TWI_POLLED
+
+// Each spin of _twi_poll takes roughly 10 cycles.
+#define TWI_POLLED_SPINS ((uint32_t)TWI_POLLED_TIMEOUT_US * (F_CPU / 1000000UL) / 10)
+
+// Wait for TWINT, returns TW_STATUS or TWI_TIMEDOUT once the budget is spent.
+static uint8_t _twi_poll(uint32_t* spins)
+{
+  while (!(TWCR & _BV(TWINT)))
+  {
+    if (!--*spins)
+      return TWI_TIMEDOUT;
+  }
+  return TW_STATUS;
+}
+
+static TWI_STATUS _twi_master_polled(uint8_t address, TWI_MASTER_RW* rw_data, uint8_t operation)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (operation == TW_READ && (rw_data->data_sz == 0 || rw_data->progmem))
+    return TWI_INVALID;
+
+  uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
+  if (!rw_data->no_start) // only include TWSTA if not requested to not send a start
+    twcr |= _BV(TWSTA);
+
+  // Claim the bus from the interrupt driven path. While the state is busy no
+  // caller or background transfer will start, and with TWIE cleared TWI_vect
+  // will not run. A caller that has not yet collected the status of its
+  // transfer still owns the bus, see _twi_wait_for_complete. TWINT already
+  // set is a slave exchange TWI_vect has yet to see, e.g. with interrupts
+  // disabled, writing TWCR would clear it from under TWI_vect.
+  uint32_t spins = TWI_POLLED_SPINS;
+  uint8_t claimed = 0;
+  for (;;)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      if (data.state == TWI_STATE_IDLE && !_twi_background() && !data.slave && !data.waiting &&
+        !(TWCR & _BV(TWINT)))
+      {
+        data.state = TWI_STATE_BUSY;
+        TWCR = twcr;
+        claimed = 1;
+      }
+    }
+    if (claimed)
+      break;
+    if (!--spins)
+      return TWI_TIMEDOUT;
+  }
+
+  uint8_t status = _twi_poll(&spins);
+  if (status == TW_START || status == TW_REP_START)
+  {
+    TWDR = (address << 1) | operation;
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
+    status = _twi_poll(&spins);
+  }
+
+  uint8_t ix = 0;
+  if (status == TW_MT_SLA_ACK)
+  {
+    while (ix < rw_data->data_sz)
+    {
+      TWDR = rw_data->progmem ? pgm_read_byte(&rw_data->data[ix]) : rw_data->data[ix];
+      ++ix;
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
+      status = _twi_poll(&spins);
+      if (status != TW_MT_DATA_ACK)
+        break;
+    }
+  }
+  else if (status == TW_MR_SLA_ACK)
+  {
+    while (ix < rw_data->data_sz)
+    {
+      twcr = _BV(TWINT) | _BV(TWEN);
+      if (ix + 1 != rw_data->data_sz) // there is room for one more
+        twcr |= _BV(TWEA);
+      TWCR = twcr;
+      status = _twi_poll(&spins);
+      if (status != TW_MR_DATA_ACK && status != TW_MR_DATA_NACK)
+        break;
+      rw_data->data[ix++] = TWDR;
+    }
+  }
+
+  switch (status)
+  {
+    case TWI_TIMEDOUT:
+      _twi_timeout(1);
+      return TWI_TIMEDOUT;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_ACK:
+    case TW_MT_DATA_NACK:
+    case TW_MR_SLA_NACK:
+    case TW_MR_DATA_NACK:
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+      while (TWCR & _BV(TWSTO))
+      {
+        if (!--spins)
+        {
+          _twi_timeout(1);
+          return TWI_TIMEDOUT;
+        }
+      }
+      TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+      break;
+
+    case TW_MT_ARB_LOST: // this is also TW_MR_ARB_LOST
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+      break;
+
+    default:
+      // e.g. addressed as a slave after losing arbitration, leave TWINT set
+      // for TWI_vect to handle.
+      TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+      break;
+  }
+
+  // data.tw_status is left alone, it may still be owed to a blocking caller.
+  data.state = TWI_STATE_IDLE;
+  _twi_kick();
+  return status;
+}
+
+TWI_STATUS twi_master_tx_polled(uint8_t address, TWI_MASTER_RW* tx_data)
+{
+  return _twi_master_polled(address, tx_data, TW_WRITE);
+}
+
+TWI_STATUS twi_master_rx_polled(uint8_t address, TWI_MASTER_RW* rx_data)
+{
+  return _twi_master_polled(address, rx_data, TW_READ);
+}
+
+#endif // TWI_POLLED
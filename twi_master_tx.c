@@ -10,3 +10,28 @@ TWI_STATUS twi_master_tx(uint8_t address, TWI_MASTER_RW* tx_data)
 {
   return _twi_master(address, tx_data, TW_WRITE);
 }
+
+TWI_STATUS twi_master_tx_segments(uint8_t address, const TWI_MASTER_SEGMENT* segments, uint8_t segments_sz)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (segments_sz == 0)
+    return TWI_INVALID;
+
+  TWI_MASTER_RW tx_data =
+  {
+    .data = (uint8_t*)segments[0].data,
+    .data_sz = segments[0].data_sz,
+    .no_start = 0,
+    .posted_write = 0,
+    .progmem = segments[0].progmem
+  };
+
+  if (_twi_start(address, &tx_data, TW_WRITE, 0, segments, segments_sz) == TWI_TIMEDOUT)
+  {
+    return TWI_TIMEDOUT;
+  }
+
+  return _twi_wait_for_complete();
+}
@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#include <util/delay.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#define TWI_POSTED_NONE 0xFF
+
+typedef struct
+{
+  uint8_t address;
+  uint8_t size;
+  uint8_t next;   // next block in the free list or the queue
+  const uint8_t* progmem; // data in program memory is sent from there, not buffer
+  uint8_t buffer[TWI_POSTED_BLOCK_SZ];
+} TWI_POSTED_BLOCK;
+
+static TWI_POSTED_BLOCK blocks[TWI_POSTED_BLOCK_CNT];
+static volatile uint8_t free_head = TWI_POSTED_NONE;
+static volatile uint8_t queue_head = TWI_POSTED_NONE;
+static volatile uint8_t queue_tail = TWI_POSTED_NONE;
+static volatile uint8_t dropped = 0;
+
+static uint8_t _twi_posted_alloc()
+{
+  uint8_t ix;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    ix = free_head;
+    if (ix != TWI_POSTED_NONE)
+      free_head = blocks[ix].next;
+  }
+  return ix;
+}
+
+uint8_t _twi_posted_load()
+{
+  if (queue_head == TWI_POSTED_NONE)
+    return 0;
+
+  TWI_POSTED_BLOCK* block = &blocks[queue_head];
+  data.address = block->address;
+  data.buffer = block->progmem ? (uint8_t*)block->progmem : block->buffer;
+  data.buffer_sz = block->size;
+  data.buffer_ix = 0;
+  data.progmem = block->progmem != NULL;
+  data.segments_sz = 0;
+  data.posted = 1;
+  data.state = TWI_STATE_BUSY;
+  return 1;
+}
+
+uint8_t _twi_posted_pending()
+{
+  return queue_head != TWI_POSTED_NONE;
+}
+
+void _twi_posted_reset()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    uint8_t i = 0;
+    for (; i < TWI_POSTED_BLOCK_CNT; ++i)
+      blocks[i].next = i + 1;
+    blocks[TWI_POSTED_BLOCK_CNT - 1].next = TWI_POSTED_NONE;
+    free_head = 0;
+    queue_head = TWI_POSTED_NONE;
+    queue_tail = TWI_POSTED_NONE;
+    data.posted = 0;
+  }
+}
+
+void _twi_posted_done()
+{
+  if (!data.posted)
+    return;
+
+  if (data.tw_status != TW_MT_SLA_ACK && data.tw_status != TW_MT_DATA_ACK && dropped != 0xFF)
+    ++dropped;
+
+  uint8_t ix = queue_head;
+  queue_head = blocks[ix].next;
+  if (queue_head == TWI_POSTED_NONE)
+    queue_tail = TWI_POSTED_NONE;
+  blocks[ix].next = free_head;
+  free_head = ix;
+  data.posted = 0;
+}
+
+uint8_t twi_posted_dropped()
+{
+  uint8_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    count = dropped;
+    dropped = 0;
+  }
+  return count;
+}
+
+TWI_STATUS _twi_posted_write(uint8_t address, TWI_MASTER_RW* tx_data)
+{
+  if (!tx_data->progmem && tx_data->data_sz > TWI_POSTED_BLOCK_SZ)
+  {
+#ifdef TWI_POSTED_WAIT
+    TWI_MASTER_RW rw_data = *tx_data;
+    rw_data.posted_write = 0;
+    return _twi_master(address, &rw_data, TW_WRITE);
+#else
+    return TWI_POOL_FULL;
+#endif
+  }
+
+  uint8_t ix = _twi_posted_alloc();
+#ifdef TWI_POSTED_WAIT
+  uint8_t timeout_cntr = data.timeout;
+  for (; ix == TWI_POSTED_NONE && timeout_cntr > 0; --timeout_cntr)
+  {
+    _twi_kick();
+    _delay_us(DELAY_US);
+    ix = _twi_posted_alloc();
+  }
+
+  if (ix == TWI_POSTED_NONE)
+  {
+    _twi_timeout(0);
+    return TWI_TIMEDOUT;
+  }
+#else
+  if (ix == TWI_POSTED_NONE)
+    return TWI_POOL_FULL;
+#endif
+
+  TWI_POSTED_BLOCK* block = &blocks[ix];
+  block->address = (address << 1) | TW_WRITE;
+  block->size = tx_data->data_sz;
+  block->next = TWI_POSTED_NONE;
+  block->progmem = NULL;
+  if (tx_data->progmem) // program memory can't change under us, no copy needed
+    block->progmem = tx_data->data;
+  else
+    memcpy(block->buffer, tx_data->data, tx_data->data_sz);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (queue_tail == TWI_POSTED_NONE)
+      queue_head = ix;
+    else
+      blocks[queue_tail].next = ix;
+    queue_tail = ix;
+  }
+
+  // Queued behind anything in flight, including a repeated start held for a
+  // caller's next transfer, the write starts once the bus is idle.
+  _twi_kick();
+  return TWI_NO_WAIT;
+}
@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#include <util/atomic.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#ifdef TWI_SCAN
+
+static volatile uint8_t scan_first = 0;
+static volatile uint8_t scan_last = 0;
+static volatile uint8_t scan_next = 0;      // next address to probe
+static volatile uint8_t scan_pending = 0;   // addresses are left to probe
+static volatile uint8_t scan_burst = 0;     // probes left in this burst
+static volatile uint8_t scan_restart = 0;   // twi_scan was called during a burst
+static volatile uint16_t scan_period = 0;
+static volatile uint16_t scan_countdown = 0;
+static volatile TWI_SCAN_CHANGE scan_callback = NULL;
+static volatile TWI_STATUS scan_status = TWI_NO_INFO;
+static volatile uint8_t present[16];
+
+TWI_STATUS twi_scan(uint8_t first, uint8_t last, uint16_t period, TWI_SCAN_CHANGE change_callback)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (first > last || last > 127)
+    return TWI_INVALID;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    scan_first = first;
+    scan_last = last;
+    // The burst in flight still probes from scan_next, restart once it ends.
+    if (data.scan)
+      scan_restart = 1;
+    else
+      scan_next = first;
+    scan_period = period;
+    scan_countdown = period;
+    scan_callback = change_callback;
+    scan_pending = 1;
+    scan_status = TWI_NO_WAIT;
+  }
+
+  _twi_kick();
+  return TWI_NO_WAIT;
+}
+
+void twi_scan_tick()
+{
+  if (!scan_period || --scan_countdown)
+    return;
+
+  scan_countdown = scan_period;
+  if (!scan_pending)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      scan_next = scan_first;
+      scan_pending = 1;
+      scan_status = TWI_NO_WAIT;
+    }
+    _twi_kick();
+  }
+}
+
+uint8_t twi_scan_present(uint8_t address)
+{
+  return (present[(address >> 3) & 0x0F] >> (address & 7)) & 1;
+}
+
+TWI_STATUS twi_scan_status()
+{
+  return scan_status;
+}
+
+uint8_t _twi_scan_load()
+{
+  if (!scan_pending)
+    return 0;
+
+  data.address = (scan_next << 1) | TW_WRITE;
+  data.buffer = NULL;
+  data.buffer_sz = 0;
+  data.buffer_ix = 0;
+  data.progmem = 0;
+  data.segments_sz = 0;
+  data.scan = 1;
+  data.state = TWI_STATE_BUSY;
+  scan_burst = TWI_SCAN_BURST;
+  return 1;
+}
+
+TWI_ACTION _twi_scan_probe(uint8_t ack)
+{
+  uint8_t address = data.address >> 1;
+  volatile uint8_t* bits = &present[address >> 3];
+  uint8_t mask = _BV(address & 7);
+  if (!(*bits & mask) != !ack)
+  {
+    *bits ^= mask;
+    if (scan_callback)
+      scan_callback(address, ack);
+  }
+
+  // The range was replaced, end the burst and start over, see _twi_scan_done.
+  if (scan_restart)
+    return TWI_ACTION_STOP;
+
+  if (address >= scan_last)
+  {
+    scan_pending = 0;
+    scan_status = TWI_OK;
+    return TWI_ACTION_STOP;
+  }
+
+  scan_next = address + 1;
+  if (--scan_burst == 0)
+    return TWI_ACTION_STOP;
+
+  // Probe the next address with a repeated start.
+  data.address = (scan_next << 1) | TW_WRITE;
+  return TWI_ACTION_START;
+}
+
+void _twi_scan_done()
+{
+  if (!data.scan)
+    return;
+
+  data.scan = 0;
+  if (scan_restart)
+  {
+    scan_restart = 0;
+    scan_next = scan_first;
+  }
+}
+
+#endif // TWI_SCAN
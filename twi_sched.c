@@ -0,0 +1,178 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#include <util/atomic.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#ifdef TWI_SCHED
+
+typedef struct
+{
+  uint16_t countdown;           // ticks until the job is due
+  uint8_t  due;
+  uint8_t  published;           // index of the sample readers see
+  uint8_t  status;              // status of the last read
+  TWI_SCHED_SAMPLE samples[2];  // the other sample is written by TWI_vect
+} TWI_SCHED_SLOT;
+
+static const TWI_SCHED_JOB* volatile sched_jobs = NULL;
+static volatile uint8_t sched_count = 0;
+static volatile uint8_t sched_current = 0;    // job in flight, or last run
+static volatile uint16_t sched_ticks = 0;
+static TWI_SCHED_SLOT slots[TWI_SCHED_MAX_JOBS];
+
+TWI_STATUS twi_sched(const TWI_SCHED_JOB* jobs, uint8_t count)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (count > TWI_SCHED_MAX_JOBS)
+    return TWI_INVALID;
+
+  uint8_t i = 0;
+  for (; i < count; ++i)
+  {
+    if (jobs[i].data_sz == 0 || jobs[i].data_sz > TWI_SCHED_DATA_SZ || jobs[i].period == 0)
+      return TWI_INVALID;
+  }
+
+  twi_sched_stop();
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    // A read still in flight from a previous table is discarded, see _twi_sched_done.
+    memset(slots, 0, sizeof(slots));
+    for (i = 0; i < count; ++i)
+    {
+      slots[i].countdown = 1;
+      slots[i].status = TWI_NO_INFO;
+    }
+    sched_jobs = jobs;
+    sched_count = count;
+    sched_current = TWI_SCHED_MAX_JOBS;
+  }
+
+  return TWI_OK;
+}
+
+TWI_STATUS twi_sched_stop()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    sched_count = 0;
+  }
+  return TWI_OK;
+}
+
+void twi_sched_tick()
+{
+  ++sched_ticks;
+
+  uint8_t i = 0;
+  for (; i < sched_count; ++i)
+  {
+    if (--slots[i].countdown == 0)
+    {
+      slots[i].countdown = sched_jobs[i].period;
+      slots[i].due = 1;
+    }
+  }
+
+  _twi_kick();
+}
+
+TWI_STATUS twi_sched_read(uint8_t job, TWI_SCHED_SAMPLE* sample)
+{
+  TWI_STATUS status;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (job >= sched_count)
+    {
+      status = TWI_INVALID;
+    }
+    else
+    {
+      TWI_SCHED_SLOT* slot = &slots[job];
+      status = slot->status;
+      if (status != TWI_NO_INFO)
+        *sample = slot->samples[slot->published];
+    }
+  }
+  return status;
+}
+
+uint8_t _twi_sched_load()
+{
+  // Round robin from the job after the last one run, so a short period job
+  // can't starve the others.
+  uint8_t i = 0;
+  uint8_t ix = sched_current;
+  for (; i < sched_count; ++i)
+  {
+    if (++ix >= sched_count)
+      ix = 0;
+    if (slots[ix].due)
+      break;
+  }
+
+  if (i == sched_count)
+    return 0;
+
+  slots[ix].due = 0;
+  sched_current = ix;
+  data.address = (sched_jobs[ix].address << 1) | TW_WRITE;
+  data.buffer = (uint8_t*)&sched_jobs[ix].reg;
+  data.buffer_sz = 1;
+  data.buffer_ix = 0;
+  data.progmem = 0;
+  data.segments_sz = 0;
+  data.sched = 1;
+  data.state = TWI_STATE_BUSY;
+  return 1;
+}
+
+TWI_ACTION _twi_sched_complete()
+{
+  // The read has completed, or the table was replaced while in flight, stop.
+  if ((data.address & TW_READ) || sched_current >= sched_count)
+    return TWI_ACTION_STOP;
+
+  // The register address has been written, read into the unpublished sample.
+  TWI_SCHED_SLOT* slot = &slots[sched_current];
+  data.address |= TW_READ;
+  data.buffer = slot->samples[!slot->published].data;
+  data.buffer_sz = sched_jobs[sched_current].data_sz;
+  data.buffer_ix = 0;
+  return TWI_ACTION_START;
+}
+
+void _twi_sched_done()
+{
+  if (!data.sched)
+    return;
+
+  data.sched = 0;
+  if (sched_current >= sched_count)
+    return;
+
+  TWI_SCHED_SLOT* slot = &slots[sched_current];
+  if (data.tw_status == TW_MR_DATA_NACK)
+  {
+    TWI_SCHED_SAMPLE* sample = &slot->samples[!slot->published];
+    sample->seq = slot->samples[slot->published].seq + 1;
+    if (sample->seq == 0)
+      sample->seq = 1;
+    sample->timestamp = sched_ticks;
+    slot->published = !slot->published;
+    slot->status = TWI_OK;
+  }
+  else
+  {
+    slot->status = data.tw_status;
+  }
+}
+
+#endif // TWI_SCHED
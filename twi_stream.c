@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <util/twi.h>
+#include <util/atomic.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#ifdef TWI_STREAM
+
+static uint8_t* volatile ring = NULL;
+static volatile uint8_t ring_sz = 0;
+static volatile uint8_t ring_head = 0;
+static volatile uint8_t ring_tail = 0;
+static volatile uint8_t ring_used = 0;
+static volatile uint16_t remaining = 0;   // bytes left to read, 0 to read until stopped
+static volatile uint8_t watermark = 0;
+static volatile TWI_STREAM_WATERMARK watermark_callback = NULL;
+static volatile uint8_t stop = 0;
+static volatile uint8_t held = 0;         // SCL held low and TWIE off, the ring is full
+static volatile TWI_STATUS stream_status = TWI_NO_INFO;
+
+// Receive the next byte, ACK'ing it unless it is the last one.
+static void _twi_stream_resume()
+{
+  uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+  if (remaining != 1 && !stop)
+    twcr |= _BV(TWEA);
+  TWCR = twcr;
+}
+
+TWI_STATUS twi_master_rx_stream(uint8_t address, TWI_MASTER_STREAM* stream)
+{
+  if (data.state == TWI_STATE_NOT_INIT)
+    return TWI_NOT_INIT;
+
+  if (stream->buffer_sz == 0 || stream_status == TWI_NO_WAIT)
+    return TWI_INVALID;
+
+  ring = stream->buffer;
+  ring_sz = stream->buffer_sz;
+  ring_head = 0;
+  ring_tail = 0;
+  ring_used = 0;
+  remaining = stream->count;
+  watermark = stream->watermark;
+  watermark_callback = stream->watermark_callback;
+  stop = 0;
+  held = 0;
+  stream_status = TWI_NO_WAIT;
+
+  TWI_MASTER_RW rx_data =
+  {
+    .data = stream->buffer,
+    .data_sz = stream->buffer_sz,
+    .no_start = 0,
+    .posted_write = 0,
+    .progmem = 0
+  };
+
+  if (_twi_start(address, &rx_data, TW_READ, 1, NULL, 0) == TWI_TIMEDOUT)
+  {
+    stream_status = TWI_TIMEDOUT;
+    return TWI_TIMEDOUT;
+  }
+
+  return TWI_NO_WAIT;
+}
+
+uint8_t twi_stream_read(uint8_t* buffer, uint8_t buffer_sz)
+{
+  // Only TWI_vect writes at the head, only this reads from the tail.
+  uint8_t count = ring_used;
+  if (count > buffer_sz)
+    count = buffer_sz;
+
+  uint8_t tail = ring_tail;
+  uint8_t i = 0;
+  for (; i < count; ++i)
+  {
+    buffer[i] = ring[tail];
+    if (++tail == ring_sz)
+      tail = 0;
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    ring_tail = tail;
+    ring_used -= count;
+    if (held && count)
+    {
+      held = 0;
+      _twi_stream_resume();
+    }
+  }
+
+  return count;
+}
+
+TWI_STATUS twi_stream_stop()
+{
+  stop = 1;
+  return TWI_OK;
+}
+
+TWI_STATUS twi_stream_status()
+{
+  return stream_status;
+}
+
+void _twi_stream_rx()
+{
+  if (data.tw_status != TW_MR_SLA_ACK)
+  {
+    ring[ring_head] = TWDR;
+    if (++ring_head == ring_sz)
+      ring_head = 0;
+    if (remaining)
+      --remaining;
+    if (++ring_used == watermark && watermark_callback)
+      watermark_callback(ring_used);
+  }
+
+  if (data.tw_status == TW_MR_DATA_NACK) // last byte, TWI_vect completes the transfer
+    return;
+
+  if (ring_used == ring_sz)
+  {
+    // Leave TWINT set, holding SCL low until twi_stream_read makes room. TWIE
+    // is cleared so TWI_vect doesn't fire again for the byte just stored,
+    // _twi_stream_resume sets it again.
+    held = 1;
+    TWCR = _BV(TWEN);
+    return;
+  }
+
+  _twi_stream_resume();
+}
+
+void _twi_stream_done()
+{
+  if (!data.stream)
+    return;
+
+  data.stream = 0;
+  held = 0;
+  stream_status = data.tw_status;
+  if (watermark_callback)
+    watermark_callback(ring_used);
+}
+
+#endif // TWI_STREAM
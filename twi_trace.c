@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "twi.h"
+#include "twi_int.h"
+
+#ifdef TWI_TRACE
+
+static TWI_TRACE_RECORD trace[TWI_TRACE_SZ];
+static volatile uint8_t trace_head = 0;   // free running, next record to write
+static volatile uint8_t trace_tail = 0;   // free running, oldest record
+static volatile uint8_t trace_lost = 0;
+
+void _twi_trace(uint16_t timestamp, uint8_t action)
+{
+  // Called at the end of TWI_vect, once TWCR has been written, so the bus is
+  // not held up while the record is stored.
+  uint8_t head = trace_head;
+  TWI_TRACE_RECORD* record = &trace[head & (TWI_TRACE_SZ - 1)];
+  record->timestamp = timestamp;
+  record->tw_status = data.tw_status;
+  record->twcr = TWCR;
+  record->buffer_ix = data.buffer_ix;
+  record->action = action;
+  trace_head = ++head;
+
+  if ((uint8_t)(head - trace_tail) > TWI_TRACE_SZ)
+  {
+    ++trace_tail;
+    if (trace_lost != 0xFF)
+      ++trace_lost;
+  }
+}
+
+static uint8_t _twi_trace_copy(TWI_TRACE_RECORD* records, uint8_t count, uint8_t drain)
+{
+  uint8_t i = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    uint8_t tail = trace_tail;
+    for (; i < count && tail != trace_head; ++i, ++tail)
+      records[i] = trace[tail & (TWI_TRACE_SZ - 1)];
+    if (drain)
+      trace_tail = tail;
+  }
+  return i;
+}
+
+uint8_t twi_trace_snapshot(TWI_TRACE_RECORD* records, uint8_t count)
+{
+  return _twi_trace_copy(records, count, 0);
+}
+
+uint8_t twi_trace_drain(TWI_TRACE_RECORD* records, uint8_t count)
+{
+  return _twi_trace_copy(records, count, 1);
+}
+
+uint8_t twi_trace_lost()
+{
+  uint8_t lost;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    lost = trace_lost;
+    trace_lost = 0;
+  }
+  return lost;
+}
+
+#endif // TWI_TRACE